@@ -7,7 +7,7 @@
  * @brief Module entry point: called when the module is loaded.
  * @return int: 0 representing success and any other value representing failure.
  */
-int simple_init(void)
+static int simple_init(void)
 {
   /* priority flag */
   printk(KERN_INFO "Loading Module\n");
@@ -18,10 +18,12 @@ int simple_init(void)
 /**
  * @brief Module exit point: called when the module is removed.
  */
-void simple_exit(void) {
+static void simple_exit(void) {
   printk(KERN_INFO "Removing Module\n");
 }
 
+/* The KUnit suite includes this file and registers a module of its own. */
+#ifndef KUNIT_TEST_INCLUDED
 /* Macros for registering module entry and exit points. */
 module_init(simple_init);
 module_exit(simple_exit);
@@ -29,3 +31,4 @@ module_exit(simple_exit);
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Simple Module");
 MODULE_AUTHOR("SGG");
+#endif
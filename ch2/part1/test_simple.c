@@ -0,0 +1,32 @@
+#include <kunit/test.h>
+
+/* test the module as is */
+#define KUNIT_TEST_INCLUDED
+#include "simple.c"
+
+
+static void TestSimpleInit(struct kunit* test) {
+  KUNIT_EXPECT_EQ(test, simple_init(), 0);
+}
+
+static void TestSimpleExit(struct kunit* test) {
+  /* nothing to check but that it returns */
+  simple_exit();
+}
+
+static struct kunit_case simple_test_cases[] = {
+  KUNIT_CASE(TestSimpleInit),
+  KUNIT_CASE(TestSimpleExit),
+  {}
+};
+
+static struct kunit_suite simple_test_suite = {
+  .name = "simple",
+  .test_cases = simple_test_cases,
+};
+
+kunit_test_suite(simple_test_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("KUnit tests of the simple module.");
+MODULE_AUTHOR("Lai-YT");
@@ -1,7 +1,12 @@
+#include <linux/errno.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/rbtree.h>
+#include <linux/sched.h>  /* cond_resched */
 #include <linux/slab.h>
 #include <linux/types.h>  /* struct list_head */
 
@@ -12,77 +17,298 @@ typedef struct {
   int month;
   int year;
   struct list_head list;
+  struct rb_node node;  /* in the index, ordered by date */
 } Birthday;
 
+/// How many elements are printed to (or reported deleted in) the log buffer at most.
+#define PRINT_LIMIT 10
+
+static unsigned long bulk_count = 0;
+module_param(bulk_count, ulong, 0444);
+MODULE_PARM_DESC(bulk_count, "Number of random birthdays to load in bulk at module init (default: 0)");
+
+/* all Birthday elements are allocated from this dedicated cache */
+static struct kmem_cache* birthday_cache = NULL;
+
+/* the index of the elements in "birthday_list", ordered by date */
+static struct rb_root birthday_index = RB_ROOT;
+
 /**
  * @brief Allocates a Birthday element with its date content initialized.
  * @param day, month, year The day, month, year of the initialized element.
- * @return Birthday*: A pointer to the newly allocated Birthday element.
+ * @return Birthday*: A pointer to the newly allocated Birthday element; NULL if out of memory.
  */
-Birthday* AllocateNewBirthday(const int day, const int month, const int year) {
-  Birthday* birthday = kmalloc(sizeof(*birthday), GFP_KERNEL /* may sleep and swap to free memory */);
+static Birthday* AllocateNewBirthday(const int day, const int month, const int year) {
+  Birthday* birthday = kmem_cache_alloc(birthday_cache, GFP_KERNEL /* may sleep and swap to free memory */);
+  if (!birthday) {
+    return NULL;
+  }
   birthday->day = day;
   birthday->month = month;
   birthday->year = year;
   /* initialize the "list" member */
   INIT_LIST_HEAD(&birthday->list);
+  RB_CLEAR_NODE(&birthday->node);
   return birthday;
 }
 
+/**
+ * @return int: The date as YYYYMMDD, which orders dates chronologically.
+ */
+static int DateKey(const int day, const int month, const int year) {
+  return year * 10000 + month * 100 + day;
+}
+
+/**
+ * @brief Inserts the Birthday element into the index. Elements of the same date are kept in
+ * insertion order.
+ */
+static void IndexBirthday(struct rb_root* root, Birthday* birthday) {
+  const int key = DateKey(birthday->day, birthday->month, birthday->year);
+  struct rb_node** link = &root->rb_node;
+  struct rb_node* parent = NULL;
+  while (*link) {
+    Birthday* curr = rb_entry(*link, Birthday, node);
+    parent = *link;
+    if (key < DateKey(curr->day, curr->month, curr->year)) {
+      link = &(*link)->rb_left;
+    } else {
+      link = &(*link)->rb_right;
+    }
+  }
+  rb_link_node(&birthday->node, parent, link);
+  rb_insert_color(&birthday->node, root);
+}
+
+/**
+ * @brief Finds a Birthday element of the date in O(log n).
+ * @return Birthday*: The first element inserted with the date; NULL if there's none.
+ */
+static Birthday* FindBirthday(struct rb_root* root, const int day, const int month, const int year) {
+  const int key = DateKey(day, month, year);
+  struct rb_node* curr_node = root->rb_node;
+  Birthday* found = NULL;
+  while (curr_node) {
+    Birthday* curr = rb_entry(curr_node, Birthday, node);
+    const int curr_key = DateKey(curr->day, curr->month, curr->year);
+    if (key < curr_key) {
+      curr_node = curr_node->rb_left;
+    } else if (key > curr_key) {
+      curr_node = curr_node->rb_right;
+    } else {
+      /* keep going left for an earlier inserted one */
+      found = curr;
+      curr_node = curr_node->rb_left;
+    }
+  }
+  return found;
+}
+
 /**
  * @brief Prints the date contents of Birthday elements to kernel log buffer in format MM/DD/YYYY.
+ * Only the first PRINT_LIMIT elements are printed.
  * @param head The head of the list which links the elements to be print.
+ * @return int: The number of elements printed.
  */
-void PrintBirthdaysToLogBuffer(struct list_head* head) {
+static int PrintBirthdaysToLogBuffer(struct list_head* head) {
   int i = 1;
   Birthday* curr_birthday = NULL;
   list_for_each_entry(curr_birthday /* points to the entry in each iteration */,
                       head,
                       list /* name of the list_head member in Birthday */) {
+    if (i > PRINT_LIMIT) {
+      printk(KERN_INFO "...\n");
+      break;
+    }
     printk(KERN_INFO "Birthday %d has date %02d/%02d/%d.\n",
            i++, curr_birthday->month, curr_birthday->day, curr_birthday->year);
   }
+  return i - 1;
 }
 
 /**
- * @brief Frees (deallocate) all Birthday elements linked in the list.
+ * @brief Frees (deallocate) all Birthday elements linked in the list without printing anything,
+ * so that the cost of freeing can be measured on its own.
+ * The index of the elements, if any, is to be reset by the caller.
  * @param head The head of the list which links the elements to be free.
+ * @return unsigned long: The number of elements freed.
  */
-void FreeBirthdayList(struct list_head* head) {
-  int i = 1;
+static unsigned long FreeBirthdaysQuietly(struct list_head* head) {
+  unsigned long count = 0;
   /* "next" is an extra pointer to maintain the list under entry modifications */
   Birthday* curr = NULL, * next = NULL;
   list_for_each_entry_safe(curr, next, head, list) {
     list_del(&curr->list);
-    kfree(curr);
-    printk(KERN_INFO "Birthday %d is deleted!\n", i++);
+    kmem_cache_free(birthday_cache, curr);
+    if (++count % 4096 == 0) {
+      cond_resched();  /* a huge list takes a while */
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Reports the deletion of `count` Birthday elements to kernel log buffer.
+ * Only the first PRINT_LIMIT elements are reported one by one.
+ */
+static void PrintDeletionsToLogBuffer(const unsigned long count) {
+  unsigned long i = 1;
+  for (; i <= count && i <= PRINT_LIMIT; ++i) {
+    printk(KERN_INFO "Birthday %lu is deleted!\n", i);
+  }
+  if (count > PRINT_LIMIT) {
+    printk(KERN_INFO "... %lu birthdays are deleted in total!\n", count);
   }
 }
 
+/**
+ * @brief Frees (deallocate) all Birthday elements linked in the list and reports the deletions.
+ * The index of the elements, if any, is to be reset by the caller.
+ * @param head The head of the list which links the elements to be free.
+ * @return unsigned long: The number of elements freed.
+ */
+static unsigned long FreeBirthdayList(struct list_head* head) {
+  const unsigned long count = FreeBirthdaysQuietly(head);
+  PrintDeletionsToLogBuffer(count);
+  return count;
+}
+
 /* declare a list head object */
-LIST_HEAD(birthday_list);
+static LIST_HEAD(birthday_list);
+
+/**
+ * @brief Adds the Birthday element into both the list and the index.
+ */
+static void AddBirthday(Birthday* birthday) {
+  /* add into the list structure */
+  list_add_tail(&birthday->list, &birthday_list);
+  IndexBirthday(&birthday_index, birthday);
+}
+
+/**
+ * @return u64: A pseudo-random number from the linear congruential generator
+ * of which the state is `seed`; the same seed gives the same sequence.
+ */
+static u64 NextRandom(u64* seed) {
+  *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *seed >> 33;
+}
+
+/**
+ * @brief Generates a pseudo-random valid date.
+ */
+static void GenerateRandomDate(u64* seed, int* day, int* month, int* year) {
+  *day = NextRandom(seed) % 28 + 1;
+  *month = NextRandom(seed) % 12 + 1;
+  *year = NextRandom(seed) % 124 + 1900;
+}
+
+#define BULK_SEED 20220427ULL
+
+/**
+ * @brief Loads `bulk_count` pseudo-random Birthday elements and then looks each of them up
+ * by date, reporting how long the build and the lookups take.
+ * @return int: 0 on success; -ENOMEM if out of memory, in which case the loaded elements are
+ * left in the list for the caller to free.
+ */
+static int LoadBirthdaysInBulk(void) {
+  u64 seed = BULK_SEED;
+  unsigned long i = 0;
+  unsigned long found = 0;
+  int day = 0, month = 0, year = 0;
+  u64 start = ktime_get_ns();
+  for (i = 0; i < bulk_count; ++i) {
+    Birthday* birthday = NULL;
+    GenerateRandomDate(&seed, &day, &month, &year);
+    birthday = AllocateNewBirthday(day, month, year);
+    if (!birthday) {
+      printk(KERN_ERR "Out of memory after %lu birthdays.\n", i);
+      return -ENOMEM;
+    }
+    AddBirthday(birthday);
+    if (i % 4096 == 0) {
+      cond_resched();
+    }
+  }
+  printk(KERN_INFO "Built %lu birthdays in %llu ns.\n",
+         bulk_count, (unsigned long long)(ktime_get_ns() - start));
+
+  /* look up the very same dates again */
+  seed = BULK_SEED;
+  start = ktime_get_ns();
+  for (i = 0; i < bulk_count; ++i) {
+    GenerateRandomDate(&seed, &day, &month, &year);
+    if (FindBirthday(&birthday_index, day, month, year)) {
+      ++found;
+    }
+    if (i % 4096 == 0) {
+      cond_resched();
+    }
+  }
+  printk(KERN_INFO "Looked up %lu birthdays (%lu found) in %llu ns.\n",
+         bulk_count, found, (unsigned long long)(ktime_get_ns() - start));
+  return 0;
+}
+
+/**
+ * @brief Releases all Birthday elements along with their index, without printing anything.
+ * @return unsigned long: The number of elements freed.
+ */
+static unsigned long TearDownBirthdays(void) {
+  const unsigned long count = FreeBirthdaysQuietly(&birthday_list);
+  /* the nodes are all gone with the elements; no need to erase them one by one */
+  birthday_index = RB_ROOT;
+  return count;
+}
 
 /**
  * @brief Module entry point: creates a birthday list with 5 Birthday elements
  * and traverses them to output their date contents to kernel log buffer.
+ * Then loads `bulk_count` more elements if requested.
  */
-int InitBirthdayList(void) {
-  Birthday* birthdays[] = {
-    AllocateNewBirthday(8, 2, 1995),
-    AllocateNewBirthday(15, 12, 2000),
-    AllocateNewBirthday(21, 3, 1999),
-    AllocateNewBirthday(3, 9, 1985),
-    AllocateNewBirthday(29, 7, 1991),
-  };
+static int __maybe_unused InitBirthdayList(void) {
+  Birthday* birthdays[5] = {NULL};
   int i = 0;
+  int err = 0;
+
+  birthday_cache = kmem_cache_create("birthday", sizeof(Birthday), 0, SLAB_HWCACHE_ALIGN, NULL);
+  if (!birthday_cache) {
+    return -ENOMEM;
+  }
+
+  birthdays[0] = AllocateNewBirthday(8, 2, 1995);
+  birthdays[1] = AllocateNewBirthday(15, 12, 2000);
+  birthdays[2] = AllocateNewBirthday(21, 3, 1999);
+  birthdays[3] = AllocateNewBirthday(3, 9, 1985);
+  birthdays[4] = AllocateNewBirthday(29, 7, 1991);
+  for (i = 0; i < sizeof(birthdays) / sizeof(Birthday*); ++i) {
+    if (!birthdays[i]) {
+      for (i = 0; i < sizeof(birthdays) / sizeof(Birthday*); ++i) {
+        if (birthdays[i]) {
+          kmem_cache_free(birthday_cache, birthdays[i]);
+        }
+      }
+      kmem_cache_destroy(birthday_cache);
+      return -ENOMEM;
+    }
+  }
+
   printk(KERN_INFO "Creating birthday list...\n");
-  for (; i < sizeof(birthdays) / sizeof(Birthday*); ++i) {
-    /* add into the list structure */
-    list_add_tail(&birthdays[i]->list, &birthday_list);
+  for (i = 0; i < sizeof(birthdays) / sizeof(Birthday*); ++i) {
+    AddBirthday(birthdays[i]);
   }
 
   PrintBirthdaysToLogBuffer(&birthday_list);
 
+  if (bulk_count) {
+    err = LoadBirthdaysInBulk();
+    if (err) {
+      TearDownBirthdays();
+      kmem_cache_destroy(birthday_cache);
+      return err;
+    }
+  }
+
   printk(KERN_INFO "Creation ends.\n");
   return 0;
 }
@@ -91,18 +317,30 @@ int InitBirthdayList(void) {
  * @brief Module exit point: deletes all Birthday elements previously created in
  * the entry point..
  */
-void ExitBirthdayList(void) {
+static void __maybe_unused ExitBirthdayList(void) {
+  u64 start = 0, elapsed_ns = 0;
+  unsigned long count = 0;
   printk(KERN_INFO "Deleting birthday list...\n");
 
-  FreeBirthdayList(&birthday_list);
+  /* only the list and the index are measured, like the build and the lookups */
+  start = ktime_get_ns();
+  count = TearDownBirthdays();
+  elapsed_ns = ktime_get_ns() - start;
+  PrintDeletionsToLogBuffer(count);
+  kmem_cache_destroy(birthday_cache);
+  printk(KERN_INFO "Tore down %lu birthdays in %llu ns.\n",
+         count, (unsigned long long)elapsed_ns);
 
   printk(KERN_INFO "Deletion ends.\n");
 }
 
 
+/* The KUnit suite includes this file and registers a module of its own. */
+#ifndef KUNIT_TEST_INCLUDED
 module_init(InitBirthdayList);
 module_exit(ExitBirthdayList);
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Perform kernel data structure (circular, doubly linked list) operations.");
 MODULE_AUTHOR("Lai-YT");
+#endif
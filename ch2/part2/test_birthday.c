@@ -0,0 +1,227 @@
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/math64.h>  /* div64_u64 */
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+
+/* test the module as is, including its static helpers */
+#define KUNIT_TEST_INCLUDED
+#include "birthday.c"
+
+
+/**
+ * @brief Gives every test case a fresh cache to allocate the Birthday elements from, so that a
+ * leak fails the destruction loudly.
+ */
+static int BirthdayTestInit(struct kunit* test) {
+  birthday_cache = kmem_cache_create("birthday_test", sizeof(Birthday), 0, SLAB_HWCACHE_ALIGN, NULL);
+  KUNIT_ASSERT_NOT_NULL(test, birthday_cache);
+  return 0;
+}
+
+static void BirthdayTestExit(struct kunit* test) {
+  kmem_cache_destroy(birthday_cache);
+  birthday_cache = NULL;
+}
+
+/**
+ * @brief Builds a list, along with its index, of `count` pseudo-random Birthday elements.
+ * @return unsigned long: The number of elements actually built, which is less than `count` only if
+ * out of memory.
+ */
+static unsigned long BuildBirthdays(struct list_head* head, struct rb_root* root, const unsigned long count) {
+  u64 seed = BULK_SEED;
+  unsigned long i = 0;
+  int day = 0, month = 0, year = 0;
+  for (i = 0; i < count; ++i) {
+    Birthday* birthday = NULL;
+    GenerateRandomDate(&seed, &day, &month, &year);
+    birthday = AllocateNewBirthday(day, month, year);
+    if (!birthday) {
+      break;
+    }
+    list_add_tail(&birthday->list, head);
+    IndexBirthday(root, birthday);
+    if (i % 4096 == 0) {
+      cond_resched();
+    }
+  }
+  return i;
+}
+
+
+static void TestAllocateNewBirthday(struct kunit* test) {
+  Birthday* birthday = AllocateNewBirthday(8, 2, 1995);
+  KUNIT_ASSERT_NOT_NULL(test, birthday);
+  KUNIT_EXPECT_EQ(test, birthday->day, 8);
+  KUNIT_EXPECT_EQ(test, birthday->month, 2);
+  KUNIT_EXPECT_EQ(test, birthday->year, 1995);
+  /* not linked to anything yet */
+  KUNIT_EXPECT_TRUE(test, list_empty(&birthday->list));
+  KUNIT_EXPECT_TRUE(test, RB_EMPTY_NODE(&birthday->node));
+  kmem_cache_free(birthday_cache, birthday);
+}
+
+static void TestPrintBirthdaysToLogBuffer(struct kunit* test) {
+  LIST_HEAD(head);
+  struct rb_root root = RB_ROOT;
+  Birthday* curr = NULL;
+  int count = 0;
+
+  KUNIT_EXPECT_EQ(test, PrintBirthdaysToLogBuffer(&head), 0);
+
+  KUNIT_ASSERT_EQ(test, BuildBirthdays(&head, &root, PRINT_LIMIT / 2), (unsigned long)PRINT_LIMIT / 2);
+  KUNIT_EXPECT_EQ(test, PrintBirthdaysToLogBuffer(&head), PRINT_LIMIT / 2);
+  FreeBirthdayList(&head);
+  root = RB_ROOT;  /* the nodes are gone with the elements */
+
+  /* more than PRINT_LIMIT, so the output is cut short */
+  KUNIT_ASSERT_EQ(test, BuildBirthdays(&head, &root, PRINT_LIMIT * 2), (unsigned long)PRINT_LIMIT * 2);
+  KUNIT_EXPECT_EQ(test, PrintBirthdaysToLogBuffer(&head), PRINT_LIMIT);
+  /* printing leaves the list untouched */
+  list_for_each_entry(curr, &head, list) {
+    ++count;
+  }
+  KUNIT_EXPECT_EQ(test, count, PRINT_LIMIT * 2);
+
+  FreeBirthdayList(&head);
+}
+
+static void TestFreeBirthdayList(struct kunit* test) {
+  LIST_HEAD(head);
+  struct rb_root root = RB_ROOT;
+
+  KUNIT_EXPECT_EQ(test, FreeBirthdayList(&head), 0UL);
+
+  KUNIT_ASSERT_EQ(test, BuildBirthdays(&head, &root, 100), 100UL);
+  KUNIT_EXPECT_EQ(test, FreeBirthdayList(&head), 100UL);
+  KUNIT_EXPECT_TRUE(test, list_empty(&head));
+  /* a leaked element would also make kmem_cache_destroy complain in the exit */
+}
+
+static void TestFindBirthday(struct kunit* test) {
+  struct rb_root root = RB_ROOT;
+  Birthday* birthdays[] = {
+    AllocateNewBirthday(15, 12, 2000),
+    AllocateNewBirthday(8, 2, 1995),
+    AllocateNewBirthday(15, 12, 2000),  /* the same date as the first one */
+    AllocateNewBirthday(3, 9, 1985),
+  };
+  int i = 0;
+  bool is_all_allocated = true;
+  for (; i < ARRAY_SIZE(birthdays); ++i) {
+    is_all_allocated = is_all_allocated && birthdays[i];
+  }
+  if (!is_all_allocated) {
+    /* free those allocated before failing, or the cache destruction reports a leak instead */
+    for (i = 0; i < ARRAY_SIZE(birthdays); ++i) {
+      if (birthdays[i]) {
+        kmem_cache_free(birthday_cache, birthdays[i]);
+      }
+    }
+    KUNIT_FAIL(test, "out of memory");
+    return;
+  }
+  for (i = 0; i < ARRAY_SIZE(birthdays); ++i) {
+    IndexBirthday(&root, birthdays[i]);
+  }
+
+  KUNIT_EXPECT_PTR_EQ(test, FindBirthday(&root, 8, 2, 1995), birthdays[1]);
+  KUNIT_EXPECT_PTR_EQ(test, FindBirthday(&root, 3, 9, 1985), birthdays[3]);
+  /* the one inserted first is found among those of the same date */
+  KUNIT_EXPECT_PTR_EQ(test, FindBirthday(&root, 15, 12, 2000), birthdays[0]);
+  KUNIT_EXPECT_NULL(test, FindBirthday(&root, 1, 1, 2001));
+
+  for (i = 0; i < ARRAY_SIZE(birthdays); ++i) {
+    kmem_cache_free(birthday_cache, birthdays[i]);
+  }
+}
+
+
+/* the element counts the microbenchmarks scale over */
+static const unsigned long kBenchmarkCounts[] = {1000, 10000, 100000, 1000000};
+
+static void BenchmarkCountToDesc(const unsigned long* count, char* desc) {
+  snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%lu birthdays", *count);
+}
+
+KUNIT_ARRAY_PARAM(benchmark_counts, kBenchmarkCounts, BenchmarkCountToDesc);
+
+/**
+ * @brief Measures the cost of building, traversing, looking up and freeing the birthdays, in total
+ * and per element, so that changes of the data structures can be compared.
+ */
+static void BenchmarkBirthdays(struct kunit* test) {
+  const unsigned long count = *(const unsigned long*)test->param_value;
+  LIST_HEAD(head);
+  struct rb_root root = RB_ROOT;
+  Birthday* curr = NULL;
+  u64 seed = BULK_SEED;
+  unsigned long i = 0;
+  unsigned long traversed = 0;
+  unsigned long found = 0;
+  unsigned long freed = 0;
+  int day = 0, month = 0, year = 0;
+  u64 build_ns = 0, traverse_ns = 0, lookup_ns = 0, free_ns = 0;
+  u64 start = ktime_get_ns();
+
+  if (BuildBirthdays(&head, &root, count) != count) {
+    FreeBirthdaysQuietly(&head);
+    kunit_skip(test, "out of memory for %lu birthdays", count);
+  }
+  build_ns = ktime_get_ns() - start;
+
+  start = ktime_get_ns();
+  list_for_each_entry(curr, &head, list) {
+    /* touch the element, as a real traversal would */
+    traversed += curr->day != 0;
+  }
+  traverse_ns = ktime_get_ns() - start;
+  KUNIT_EXPECT_EQ(test, traversed, count);
+
+  start = ktime_get_ns();
+  for (i = 0; i < count; ++i) {
+    GenerateRandomDate(&seed, &day, &month, &year);
+    found += FindBirthday(&root, day, month, year) != NULL;
+  }
+  lookup_ns = ktime_get_ns() - start;
+  KUNIT_EXPECT_EQ(test, found, count);
+
+  /* the printing version would mostly measure the logging */
+  start = ktime_get_ns();
+  freed = FreeBirthdaysQuietly(&head);
+  free_ns = ktime_get_ns() - start;
+  KUNIT_EXPECT_EQ(test, freed, count);
+
+  kunit_info(test, "%lu birthdays: build %llu ns (%llu ns/op), traverse %llu ns (%llu ns/op), "
+             "lookup %llu ns (%llu ns/op), free %llu ns (%llu ns/op)\n",
+             count,
+             build_ns, div64_u64(build_ns, count),
+             traverse_ns, div64_u64(traverse_ns, count),
+             lookup_ns, div64_u64(lookup_ns, count),
+             free_ns, div64_u64(free_ns, count));
+}
+
+
+static struct kunit_case birthday_test_cases[] = {
+  KUNIT_CASE(TestAllocateNewBirthday),
+  KUNIT_CASE(TestPrintBirthdaysToLogBuffer),
+  KUNIT_CASE(TestFreeBirthdayList),
+  KUNIT_CASE(TestFindBirthday),
+  KUNIT_CASE_PARAM(BenchmarkBirthdays, benchmark_counts_gen_params),
+  {}
+};
+
+static struct kunit_suite birthday_test_suite = {
+  .name = "birthday",
+  .init = BirthdayTestInit,
+  .exit = BirthdayTestExit,
+  .test_cases = birthday_test_cases,
+};
+
+kunit_test_suite(birthday_test_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("KUnit tests and microbenchmarks of the birthday list.");
+MODULE_AUTHOR("Lai-YT");
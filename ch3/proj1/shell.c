@@ -1,7 +1,11 @@
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "fifo.h"
@@ -16,6 +20,18 @@
 #define HISTORY_SIZE 10
 
 
+/** The resources a foreground command used, as reported by `wait4`. */
+typedef struct {
+  bool is_measured;  /* false if the command hasn't been measured */
+  double real;  /* wall-clock time, in seconds */
+  double user;
+  double sys;
+  long max_rss;  /* in kilobytes */
+  long voluntary_switches;
+  long involuntary_switches;
+} usage_t;
+
+
 bool IsChildProcess(const pid_t pid);
 
 bool IsParentProcess(const pid_t pid);
@@ -34,13 +50,43 @@ void RemoveTrailingLineBreakFromLine(char *line /* in-out parameter */);
  */
 int MoveIndexOfCircularQueue(const queue_t *const queue, const int index, const int move);
 
+/** @return the time of the monotonic clock, in seconds. */
+double GetMonotonicTime(void);
+
+/**
+ * @brief Fills `usage` with the resources measured from a command.
+ * @param real        the wall-clock time the command took, in seconds
+ * @param rusage      the resources reported for the command by `wait4`
+ */
+void FillUsage(usage_t *usage, const double real, const struct rusage *const rusage);
+
+/** Prints the `usage` in one line, without the line break. */
+void PrintUsage(FILE *stream, const usage_t *const usage);
+
+/**
+ * @brief Waits for the child `pid` to terminate, retrying if interrupted by a signal.
+ * @param rusage  filled with the resources the child used
+ * @return true if the child is reaped; false if the wait fails, which leaves `rusage` undefined
+ */
+bool WaitForChild(const pid_t pid, struct rusage *rusage);
+
+/** Reaps the background children that have terminated, without blocking. */
+void ReapBackgroundChildren(void);
+
 
 int main(void) {
   char *args[MAX_LINE / 2 + 1] = {0};  /* command line arguments */
   queue_t history;
   InitQueue(&history, HISTORY_SIZE, MAX_LINE);
+  /* the usage of each command in the history, at the same index in the queue */
+  usage_t history_usages[HISTORY_SIZE + 1] = {0};
+  /* whether to measure every foreground command, not only the `time`d ones */
+  bool is_accounting = false;
 
   while (true) {
+    /* the foreground command waits for its own child only */
+    ReapBackgroundChildren();
+
     /* prompt */
     printf("osh> ");
     fflush(stdout);
@@ -74,6 +120,8 @@ int main(void) {
       char buf[MAX_LINE];
       ReadQueue(&history, buf);
     }
+    usage_t *const usage = &history_usages[MoveIndexOfCircularQueue(&history, history.tail, -1)];
+    usage->is_measured = false;  /* the slot may be reused */
 
     bool run_in_background = false;
 
@@ -96,28 +144,73 @@ int main(void) {
       } else {
         int data_count = CountQueueData(&history);
         for (int i = history.head; i != history.tail; i = MoveIndexOfCircularQueue(&history, i, 1)) {
-          printf("%d %s\n", data_count--, history.data[i]);
+          printf("%d %s", data_count--, history.data[i]);
+          if (history_usages[i].is_measured) {
+            printf("  [");
+            PrintUsage(stdout, &history_usages[i]);
+            printf("]");
+          }
+          printf("\n");
         }
       }
       continue;
     }
 
+    /* turn accounting on or off */
+    if (strcmp(args[0], "accounting") == 0) {
+      if (args[1] != NULL && strcmp(args[1], "on") == 0) {
+        is_accounting = true;
+      } else if (args[1] != NULL && strcmp(args[1], "off") == 0) {
+        is_accounting = false;
+      } else if (args[1] != NULL) {
+        printf("Usage: accounting [on|off]\n");
+        continue;
+      }
+      printf("accounting is %s\n", is_accounting ? "on" : "off");
+      continue;
+    }
+
     /* whether to run in background */
     if (strcmp(args[i - 1], "&") == 0) {
       run_in_background = true;
       args[--i] = NULL;  /* remove `&` */
     }
 
+    /* whether to time the command; `time` itself isn't part of the command */
+    char **command = args;
+    bool is_timed = false;
+    if (strcmp(args[0], "time") == 0) {
+      /* a background command isn't waited for, so can't be measured */
+      if (args[1] == NULL || run_in_background) {
+        printf("Usage: time COMMAND [ARG]...  (not in background)\n");
+        continue;
+      }
+      is_timed = true;
+      command = args + 1;
+    }
+    /* the accounting skips background commands for the same reason */
+    const bool is_measured = (is_timed || is_accounting) && !run_in_background;
+
     /* execute command */
+    const double start_time = GetMonotonicTime();
     const pid_t pid = fork();
     if (pid < 0) {  /* error occurred */
       fprintf(stderr, "Fork Failed");
       return 1;
     } else if (IsChildProcess(pid)) {
-      execvp(args[0], args);
+      execvp(command[0], command);
     } else if (IsParentProcess(pid)) {
       if (!run_in_background) {
-        wait(NULL);
+        /* waits for this very child, so that a background one which happens to
+          end meanwhile isn't taken for it */
+        struct rusage rusage;
+        if (!WaitForChild(pid, &rusage)) {
+          perror("wait4");
+        } else if (is_measured) {
+          FillUsage(usage, GetMonotonicTime() - start_time, &rusage);
+          PrintUsage(stderr, usage);
+          fprintf(stderr, "\n");
+        }
       }
     }
   }
@@ -153,3 +246,44 @@ void RemoveTrailingLineBreakFromLine(char *line) {
 int MoveIndexOfCircularQueue(const queue_t *const queue, const int index, const int move) {
   return ((index + queue->size) + move) % queue->size;
 }
+
+
+double GetMonotonicTime(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void FillUsage(usage_t *usage, const double real, const struct rusage *const rusage) {
+  usage->is_measured = true;
+  usage->real = real;
+  usage->user = rusage->ru_utime.tv_sec + rusage->ru_utime.tv_usec / 1e6;
+  usage->sys = rusage->ru_stime.tv_sec + rusage->ru_stime.tv_usec / 1e6;
+  usage->max_rss = rusage->ru_maxrss;
+  usage->voluntary_switches = rusage->ru_nvcsw;
+  usage->involuntary_switches = rusage->ru_nivcsw;
+}
+
+
+void PrintUsage(FILE *stream, const usage_t *const usage) {
+  fprintf(stream, "real %.3fs user %.3fs sys %.3fs maxrss %ldKB ctxsw %ld/%ld",
+          usage->real, usage->user, usage->sys, usage->max_rss,
+          usage->voluntary_switches, usage->involuntary_switches);
+}
+
+
+bool WaitForChild(const pid_t pid, struct rusage *rusage) {
+  pid_t waited_pid;
+  do {
+    waited_pid = wait4(pid, NULL, 0, rusage);
+  } while (waited_pid < 0 && errno == EINTR);
+  return waited_pid == pid;
+}
+
+
+void ReapBackgroundChildren(void) {
+  while (waitpid(-1, NULL, WNOHANG) > 0) {
+    /* reaped one */
+  }
+}
@@ -1,7 +1,10 @@
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "persist.h"
+#include "stats.h"
 #include "util.h"
 
 int main(int argc, const char *argv[]) {
@@ -10,8 +13,18 @@ int main(int argc, const char *argv[]) {
   pthread_mutex_init(&resource_mutex, NULL);
   pthread_mutex_init(&rand_mutex, NULL);
 
-  read_available(argc, argv);
-  init_state();
+  /* a resumed state needs neither reading nor initializing */
+  if (!persist_init()) {
+    read_available(argc, argv);
+    init_state();
+    /* without the first snapshot, the logged deltas would be discarded on the
+      next start */
+    if (!persist_compact()) {
+      printf("Error: the state can't be persisted.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  stats_init();
 
   pthread_t customers[NUMBER_OF_CUSTOMERS];
   /* NOTE: customer_nums are passed as pointers, so we have to keep them
@@ -32,6 +45,8 @@ int main(int argc, const char *argv[]) {
   }
 
   print_state();
+  stats_shutdown();
+  persist_shutdown();
 
   pthread_mutex_destroy(&resource_mutex);
   pthread_mutex_destroy(&rand_mutex);
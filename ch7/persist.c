@@ -0,0 +1,323 @@
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "persist.h"
+#include "util.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static bool is_enabled = false;
+static char state_path[PATH_MAX];
+static char log_path[PATH_MAX];
+static int log_fd = -1;
+static off_t log_size = 0; /* up to the end of the last valid delta */
+static uint64_t sequence = 0; /* of the last logged delta */
+static int deltas_since_compaction = 0;
+
+#define SIZE_OF_MEMBER(type, member) sizeof(((type *)0)->member)
+
+/* the arrays in the order they are laid out in the snapshot */
+#define NUMBER_OF_STATE_ARRAYS 4
+
+static void get_state_arrays(const int *arrays[], size_t sizes[]) {
+  arrays[0] = available;
+  sizes[0] = SIZE_OF_MEMBER(struct BankState, available);
+  arrays[1] = &maximum[0][0];
+  sizes[1] = SIZE_OF_MEMBER(struct BankState, maximum);
+  arrays[2] = &allocation[0][0];
+  sizes[2] = SIZE_OF_MEMBER(struct BankState, allocation);
+  arrays[3] = &need[0][0];
+  sizes[3] = SIZE_OF_MEMBER(struct BankState, need);
+}
+
+/**
+ * @brief Folds `size` bytes of `data`, a multiple of 4, into the FNV-1a hash
+ * `hash`, a 32-bit word at a time.
+ */
+static uint64_t checksum(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)) {
+    uint32_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    hash ^= word;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static uint64_t checksum_of_header(const struct StateHeader *header) {
+  return checksum(FNV_OFFSET_BASIS, header,
+                  offsetof(struct StateHeader, checksum));
+}
+
+static uint64_t checksum_of_record(const struct DeltaRecord *record) {
+  return checksum(FNV_OFFSET_BASIS, record,
+                  offsetof(struct DeltaRecord, checksum));
+}
+
+static double elapsed_ms(const struct timespec *start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e3 +
+         (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void apply_delta(const struct DeltaRecord *record) {
+  /* a grant moves resources from the bank to the customer and a release the
+    other way around */
+  const int sign = record->kind == DELTA_GRANT ? 1 : -1;
+  for (int i = 0; i < NUMBER_OF_RESOURCES; i++) {
+    const int amount = sign * record->amounts[i];
+    allocation[record->customer_num][i] += amount;
+    available[i] -= amount;
+    need[record->customer_num][i] -= amount;
+  }
+}
+
+static bool is_valid_record(const struct DeltaRecord *record) {
+  return record->checksum == checksum_of_record(record) &&
+         (record->kind == DELTA_GRANT || record->kind == DELTA_RELEASE) &&
+         record->customer_num >= 0 &&
+         record->customer_num < NUMBER_OF_CUSTOMERS;
+}
+
+/**
+ * @brief Maps the snapshot privately, so that the state is used in place and
+ * the changes never reach the file, and verifies it.
+ * @return false if there's no usable snapshot.
+ */
+static bool map_snapshot(void) {
+  const int fd = open(state_path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  const size_t size = sizeof(struct StateHeader) + sizeof(struct BankState);
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size != size) {
+    fprintf(stderr, "Warning: %s has an unexpected size, starting over.\n",
+            state_path);
+    close(fd);
+    return false;
+  }
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd); /* the mapping stays */
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+
+  const struct StateHeader *header = base;
+  struct BankState *state =
+      (struct BankState *)((char *)base + sizeof(struct StateHeader));
+  if (header->magic != STATE_MAGIC || header->version != STATE_VERSION ||
+      header->number_of_customers != NUMBER_OF_CUSTOMERS ||
+      header->number_of_resources != NUMBER_OF_RESOURCES ||
+      header->checksum != checksum(checksum_of_header(header), state,
+                                   sizeof(struct BankState))) {
+    fprintf(stderr, "Warning: %s isn't a valid snapshot, starting over.\n",
+            state_path);
+    munmap(base, size);
+    return false;
+  }
+  use_state(state);
+  sequence = header->sequence;
+  return true;
+}
+
+/**
+ * @brief Replays the deltas that follow the snapshot and cuts the log off at
+ * the first invalid one.
+ * @return the number of deltas replayed.
+ */
+static int replay_log(void) {
+  int replayed = 0;
+  off_t valid_end = 0;
+  struct DeltaRecord record;
+  while (read(log_fd, &record, sizeof(record)) == sizeof(record) &&
+         is_valid_record(&record)) {
+    /* deltas which are already in the snapshot are left over by a compaction
+      interrupted before the log was truncated */
+    if (record.sequence > sequence) {
+      if (record.sequence != sequence + 1) {
+        break;
+      }
+      apply_delta(&record);
+      sequence = record.sequence;
+      replayed++;
+    }
+    valid_end += sizeof(record);
+  }
+  if (ftruncate(log_fd, valid_end) < 0) {
+    perror("ftruncate");
+  }
+  log_size = valid_end;
+  return replayed;
+}
+
+bool persist_init(void) {
+  const char *path = getenv("BANK_STATE");
+  if (!path) {
+    return false;
+  }
+  if (snprintf(state_path, sizeof(state_path), "%s", path) >=
+          (int)sizeof(state_path) ||
+      snprintf(log_path, sizeof(log_path), "%s.log", path) >=
+          (int)sizeof(log_path)) {
+    printf("Error: the path of BANK_STATE is too long.\n");
+    exit(EXIT_FAILURE);
+  }
+  is_enabled = true;
+
+  log_fd = open(log_path, O_RDWR | O_CREAT, 0644);
+  if (log_fd < 0) {
+    perror(log_path);
+    exit(EXIT_FAILURE);
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!map_snapshot()) {
+    /* the log is meaningless without the snapshot it follows */
+    if (ftruncate(log_fd, 0) < 0) {
+      perror("ftruncate");
+    }
+    return false;
+  }
+  const int replayed = replay_log();
+  fprintf(stderr,
+          "Resumed from %s (sequence %lu, %d deltas replayed) in %.3f ms.\n",
+          state_path, (unsigned long)sequence, replayed, elapsed_ms(&start));
+  return true;
+}
+
+void persist_record(enum DeltaKind kind, int customer_num, int amounts[]) {
+  if (!is_enabled) {
+    return;
+  }
+  struct DeltaRecord record;
+  memset(&record, 0, sizeof(record)); /* no garbage in the padding */
+  record.sequence = sequence + 1;
+  record.kind = kind;
+  record.customer_num = customer_num;
+  for (int i = 0; i < NUMBER_OF_RESOURCES; i++) {
+    record.amounts[i] = amounts[i];
+  }
+  record.checksum = checksum_of_record(&record);
+  if (pwrite(log_fd, &record, sizeof(record), log_size) != sizeof(record)) {
+    perror(log_path);
+    /* cut off the torn record, or no delta after it would be replayed */
+    if (ftruncate(log_fd, log_size) < 0) {
+      perror("ftruncate");
+    }
+    /* the delta is already applied to the state, so without it the log no
+      longer leads to the state; a snapshot has to catch up with the state */
+    if (!persist_compact()) {
+      printf("Error: the state can't be persisted anymore.\n");
+      exit(EXIT_FAILURE);
+    }
+    return;
+  }
+  log_size += sizeof(record);
+  sequence = record.sequence;
+
+  if (++deltas_since_compaction >= COMPACTION_INTERVAL) {
+    persist_compact();
+  }
+}
+
+/** @brief Writes all `size` bytes of `data` to `fd`. */
+static bool write_fully(int fd, const void *data, size_t size) {
+  const char *bytes = data;
+  while (size > 0) {
+    const ssize_t written = write(fd, bytes, size);
+    if (written < 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool persist_compact(void) {
+  if (!is_enabled) {
+    return true;
+  }
+  const int *arrays[NUMBER_OF_STATE_ARRAYS];
+  size_t sizes[NUMBER_OF_STATE_ARRAYS];
+  get_state_arrays(arrays, sizes);
+
+  struct StateHeader header = {
+      .magic = STATE_MAGIC,
+      .version = STATE_VERSION,
+      .number_of_customers = NUMBER_OF_CUSTOMERS,
+      .number_of_resources = NUMBER_OF_RESOURCES,
+      .sequence = sequence,
+  };
+  header.checksum = checksum_of_header(&header);
+  for (int i = 0; i < NUMBER_OF_STATE_ARRAYS; i++) {
+    header.checksum = checksum(header.checksum, arrays[i], sizes[i]);
+  }
+
+  /* write aside and rename, so that a crash leaves either the old or the new
+    snapshot in place but never a partial one */
+  char tmp_path[PATH_MAX + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", state_path);
+  const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(tmp_path);
+    return false;
+  }
+  bool is_written = write_fully(fd, &header, sizeof(header));
+  for (int i = 0; is_written && i < NUMBER_OF_STATE_ARRAYS; i++) {
+    is_written = write_fully(fd, arrays[i], sizes[i]);
+  }
+  if (!is_written || fsync(fd) < 0) {
+    perror(tmp_path);
+    close(fd);
+    unlink(tmp_path);
+    return false;
+  }
+  close(fd);
+  if (rename(tmp_path, state_path) < 0) {
+    perror(state_path);
+    unlink(tmp_path);
+    return false;
+  }
+  /* makes the rename itself durable */
+  char dir_path[PATH_MAX];
+  strcpy(dir_path, state_path);
+  const int dir_fd = open(dirname(dir_path), O_RDONLY);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+
+  /* only now are the logged deltas safe to drop */
+  if (ftruncate(log_fd, 0) < 0) {
+    perror(log_path);
+  }
+  log_size = 0;
+  deltas_since_compaction = 0;
+  return true;
+}
+
+void persist_shutdown(void) {
+  if (!is_enabled) {
+    return;
+  }
+  persist_compact();
+  close(log_fd);
+}
@@ -0,0 +1,80 @@
+#ifndef PERSIST_H_
+#define PERSIST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util.h"
+
+/*
+ * Crash-consistent persistence of the bank state.
+ *
+ * The state lives in two files: a snapshot, `$BANK_STATE`, and an append-only
+ * delta log, `$BANK_STATE.log`. The snapshot is a versioned, checksummed
+ * header directly followed by a `struct BankState`, so on restart it is mapped
+ * privately and used in place rather than rebuilt; only the deltas logged
+ * since it was taken are replayed. Every `COMPACTION_INTERVAL` deltas the
+ * state is written to a new snapshot, which atomically replaces the old one,
+ * and the log is truncated.
+ *
+ * A torn or corrupted delta at the tail of the log (the process died in the
+ * middle of appending it) ends the replay; the deltas before it are kept.
+ */
+
+#define STATE_MAGIC 0x4b4e4142 /* "BANK" */
+#define STATE_VERSION 1
+
+/* how many deltas are logged before the state is compacted into a snapshot */
+#define COMPACTION_INTERVAL 1024
+
+struct StateHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t number_of_customers;
+  uint32_t number_of_resources;
+  uint64_t sequence; /* of the last delta folded into the snapshot */
+  uint64_t checksum; /* of the header fields above and the state */
+};
+
+enum DeltaKind { DELTA_GRANT = 1, DELTA_RELEASE = 2 };
+
+struct DeltaRecord {
+  uint64_t sequence;
+  int32_t kind;
+  int32_t customer_num;
+  int32_t amounts[NUMBER_OF_RESOURCES];
+  uint64_t checksum; /* of the fields above */
+};
+
+/**
+ * @brief Enables persistence if the `BANK_STATE` environment variable is set
+ * and resumes the state from it if there is a valid snapshot.
+ *
+ * @return true if the state is resumed; false if the state has to be
+ * initialized, after which `persist_compact()` takes the first snapshot.
+ */
+bool persist_init(void);
+
+/**
+ * @brief Appends a delta of the state to the log and compacts the log once it
+ * grows to `COMPACTION_INTERVAL` deltas. The caller has to hold
+ * `resource_mutex`.
+ *
+ * @details If the delta can't be appended, the state is compacted right away;
+ * the program exits if that fails too, since the persisted state could no
+ * longer be resumed.
+ */
+void persist_record(enum DeltaKind kind, int customer_num, int amounts[]);
+
+/**
+ * @brief Writes the current state to a new snapshot and empties the log.
+ * The caller has to hold `resource_mutex` if there are customers in the bank.
+ * @return false if the snapshot can't be written, in which case the old
+ * snapshot and the log are left as they are.
+ */
+bool persist_compact(void);
+
+/** @brief Takes the final snapshot and closes the files. */
+void persist_shutdown(void);
+
+#endif /* end of include guard: PERSIST_H_ */
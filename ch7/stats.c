@@ -0,0 +1,194 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stats.h"
+#include "util.h"
+
+bool stats_enabled = false;
+__thread struct ThreadStats *local_stats = NULL;
+
+static struct ThreadStats slots[NUMBER_OF_STATS_SLOTS];
+
+static pthread_t dump_thread;
+static int dump_interval; /* in seconds, 0 for no periodic dumps */
+static bool is_shutting_down = false; /* accessed atomically */
+
+static const char *const counter_names[NUMBER_OF_COUNTERS] = {
+    "requests",
+    "grants",
+    "denials",
+    "releases",
+};
+
+static const char *const histogram_names[NUMBER_OF_HISTOGRAMS] = {
+    "resource_mutex wait",
+    "resource_mutex hold",
+    "is_in_safe_state",
+    "rand_mutex wait",
+};
+
+void *dump_stats_periodically(void *unused);
+
+void stats_init(void) {
+  const char *interval = getenv("BANK_STATS");
+  if (!interval) {
+    return;
+  }
+  dump_interval = atoi(interval);
+  if (dump_interval < 0) {
+    dump_interval = 0;
+  }
+  stats_enabled = true;
+  stats_register_thread(MAIN_STATS_SLOT);
+
+  /* block SIGUSR1 before any other thread exists so that all of them inherit
+    the mask and the signal is left to the dumping thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+  pthread_create(&dump_thread, NULL, dump_stats_periodically, NULL);
+}
+
+void stats_shutdown(void) {
+  if (!stats_enabled) {
+    return;
+  }
+  __atomic_store_n(&is_shutting_down, true, __ATOMIC_RELEASE);
+  pthread_kill(dump_thread, SIGUSR1); /* wakes it up for the final dump */
+  pthread_join(dump_thread, NULL);
+}
+
+void stats_register_thread(int slot) {
+  local_stats = &slots[slot];
+}
+
+void *dump_stats_periodically(void *unused) {
+  (void)unused;
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  const struct timespec timeout = {.tv_sec = dump_interval, .tv_nsec = 0};
+
+  while (true) {
+    /* either times out for a periodic dump or is woken up by SIGUSR1 */
+    if (dump_interval > 0) {
+      sigtimedwait(&set, NULL, &timeout);
+    } else {
+      sigwaitinfo(&set, NULL);
+    }
+    if (__atomic_load_n(&is_shutting_down, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    stats_dump();
+  }
+  stats_dump();
+  return NULL;
+}
+
+uint64_t stats_lock(pthread_mutex_t *mutex, enum Histogram wait) {
+  const uint64_t start = stats_now();
+  pthread_mutex_lock(mutex);
+  if (!stats_enabled) {
+    return 0;
+  }
+  stats_record_since(wait, start);
+  return stats_now();
+}
+
+void stats_unlock(pthread_mutex_t *mutex, enum Histogram hold,
+                  uint64_t acquired_at) {
+  if (stats_enabled) {
+    stats_record_since(hold, acquired_at);
+  }
+  pthread_mutex_unlock(mutex);
+}
+
+int histogram_bucket_of(uint64_t value) {
+  if (value < HISTOGRAM_SUB_BUCKETS) {
+    return (int)value;
+  }
+  const int magnitude = 63 - __builtin_clzll(value); /* >= 3 */
+  const int sub_bucket = (int)(value >> (magnitude - 3)) & 7;
+  return (magnitude - 2) * HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t histogram_bucket_lower_bound(int bucket) {
+  if (bucket < HISTOGRAM_SUB_BUCKETS) {
+    return (uint64_t)bucket;
+  }
+  const int magnitude = bucket / HISTOGRAM_SUB_BUCKETS + 2;
+  const int sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS;
+  return (uint64_t)(HISTOGRAM_SUB_BUCKETS + sub_bucket) << (magnitude - 3);
+}
+
+/**
+ * @return the highest value equivalent to the one at `percentile` (0 ~ 100) of
+ * the merged `buckets`, which hold `total` values.
+ */
+uint64_t value_at_percentile(const uint64_t buckets[], uint64_t total,
+                             double percentile) {
+  uint64_t rank = (uint64_t)(percentile / 100 * total + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < NUMBER_OF_HISTOGRAM_BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return i + 1 < NUMBER_OF_HISTOGRAM_BUCKETS
+                 ? histogram_bucket_lower_bound(i + 1) - 1
+                 : UINT64_MAX;
+    }
+  }
+  return 0;
+}
+
+void stats_dump(void) {
+  uint64_t counters[NUMBER_OF_COUNTERS] = {0};
+  static uint64_t buckets[NUMBER_OF_HISTOGRAM_BUCKETS];
+
+  for (int s = 0; s < NUMBER_OF_STATS_SLOTS; s++) {
+    for (int c = 0; c < NUMBER_OF_COUNTERS; c++) {
+      counters[c] += __atomic_load_n(&slots[s].counters[c], __ATOMIC_RELAXED);
+    }
+  }
+  fprintf(stderr, "[STATS]\n");
+  for (int c = 0; c < NUMBER_OF_COUNTERS; c++) {
+    fprintf(stderr, "  %-8s %10lu\n", counter_names[c],
+            (unsigned long)counters[c]);
+  }
+  if (counters[COUNTER_REQUESTS]) {
+    fprintf(stderr, "  rollback rate %.1f%%\n",
+            100.0 * counters[COUNTER_DENIALS] / counters[COUNTER_REQUESTS]);
+  }
+
+  fprintf(stderr, "  %-20s %10s %10s %10s %10s %10s\n", "latency (ns)", "count",
+          "p50", "p90", "p99", "max");
+  for (int h = 0; h < NUMBER_OF_HISTOGRAMS; h++) {
+    uint64_t total = 0;
+    for (int i = 0; i < NUMBER_OF_HISTOGRAM_BUCKETS; i++) {
+      buckets[i] = 0;
+      for (int s = 0; s < NUMBER_OF_STATS_SLOTS; s++) {
+        buckets[i] +=
+            __atomic_load_n(&slots[s].histograms[h][i], __ATOMIC_RELAXED);
+      }
+      total += buckets[i];
+    }
+    if (total == 0) {
+      fprintf(stderr, "  %-20s %10d\n", histogram_names[h], 0);
+      continue;
+    }
+    fprintf(stderr, "  %-20s %10lu %10lu %10lu %10lu %10lu\n",
+            histogram_names[h], (unsigned long)total,
+            (unsigned long)value_at_percentile(buckets, total, 50),
+            (unsigned long)value_at_percentile(buckets, total, 90),
+            (unsigned long)value_at_percentile(buckets, total, 99),
+            (unsigned long)value_at_percentile(buckets, total, 100));
+  }
+}
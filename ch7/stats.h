@@ -0,0 +1,143 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "util.h"
+
+/*
+ * Low-overhead instrumentation of the bank.
+ *
+ * Every thread owns a slot of counters and latency histograms which only it
+ * writes to, so recording never takes a lock; the slots are merged on demand
+ * when the stats are dumped. Recording is switched on by the `BANK_STATS`
+ * environment variable, otherwise each recording site costs a single branch.
+ *
+ * The USDT probes (provider `bank`) are compiled in whenever <sys/sdt.h> is
+ * available and are plain nops until perf or bpftrace attaches to them, e.g.
+ *   $ bpftrace -e 'usdt:bin/bank:bank:deny { @[arg0] = count(); }'
+ */
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BANK_PROBE1(name, arg1) DTRACE_PROBE1(bank, name, arg1)
+#endif
+#endif
+#ifndef BANK_PROBE1
+#define BANK_PROBE1(name, arg1) ((void)(arg1))
+#endif
+
+enum Counter {
+  COUNTER_REQUESTS,
+  COUNTER_GRANTS,
+  COUNTER_DENIALS, /* each denial rolls back a tentatively granted request */
+  COUNTER_RELEASES,
+  NUMBER_OF_COUNTERS
+};
+
+enum Histogram {
+  HIST_RESOURCE_WAIT, /* time spent waiting for `resource_mutex` */
+  HIST_RESOURCE_HOLD, /* time `resource_mutex` is held */
+  HIST_SAFETY_CHECK,  /* time spent in `is_in_safe_state()` */
+  HIST_RAND_WAIT,     /* time spent waiting for `rand_mutex` */
+  NUMBER_OF_HISTOGRAMS
+};
+
+/* every customer has its own slot, plus one for the main thread */
+#define NUMBER_OF_STATS_SLOTS (NUMBER_OF_CUSTOMERS + 1)
+#define MAIN_STATS_SLOT NUMBER_OF_CUSTOMERS
+
+/*
+ * The histograms are log-linear, in the spirit of HdrHistogram: values below 8
+ * have a bucket each, larger ones are split into 8 sub-buckets per power of
+ * two, which keeps the relative error under 12.5% over the full 64-bit range.
+ */
+#define HISTOGRAM_SUB_BUCKETS 8
+#define NUMBER_OF_HISTOGRAM_BUCKETS (62 * HISTOGRAM_SUB_BUCKETS)
+
+struct ThreadStats {
+  uint64_t counters[NUMBER_OF_COUNTERS];
+  uint64_t histograms[NUMBER_OF_HISTOGRAMS][NUMBER_OF_HISTOGRAM_BUCKETS];
+};
+
+/* whether recording is on; fixed by `stats_init()` */
+extern bool stats_enabled;
+
+/* the slot of the calling thread, NULL if it hasn't registered one */
+extern __thread struct ThreadStats *local_stats;
+
+/**
+ * @brief Enables the stats if the `BANK_STATS` environment variable is set.
+ *
+ * @details `BANK_STATS` is the interval in seconds between periodic dumps to
+ * stderr; 0 dumps only on SIGUSR1 and at shutdown. Must be called before any
+ * other thread is created, since SIGUSR1 is blocked for the dumping thread to
+ * wait on it.
+ */
+void stats_init(void);
+
+/** @brief Dumps the final stats and stops the dumping thread, if any. */
+void stats_shutdown(void);
+
+/** @brief Makes the calling thread record into the slot `slot`. */
+void stats_register_thread(int slot);
+
+/** @brief Merges the slots of all threads and prints them to stderr. */
+void stats_dump(void);
+
+/** @return the index of the histogram bucket that `value` falls into. */
+int histogram_bucket_of(uint64_t value);
+
+/** @return the smallest value that falls into the bucket `bucket`. */
+uint64_t histogram_bucket_lower_bound(int bucket);
+
+/**
+ * @brief Locks `mutex`, recording the wait into the histogram `wait`.
+ * @return the time the lock is acquired, which is to be passed to
+ * `stats_unlock()`; 0 if the stats are off.
+ */
+uint64_t stats_lock(pthread_mutex_t *mutex, enum Histogram wait);
+
+/** @brief Unlocks `mutex`, recording how long it was held into `hold`. */
+void stats_unlock(pthread_mutex_t *mutex, enum Histogram hold,
+                  uint64_t acquired_at);
+
+/** @return the monotonic time in nanoseconds; 0 if the stats are off. */
+static inline uint64_t stats_now(void) {
+  if (!stats_enabled) {
+    return 0;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Only the owning thread writes to a slot, so a relaxed load and store is
+ * enough; the atomics merely keep the dumping thread from tearing the reads.
+ */
+static inline void stats_add(uint64_t *slot, uint64_t n) {
+  __atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + n,
+                   __ATOMIC_RELAXED);
+}
+
+static inline void stats_count(enum Counter counter) {
+  if (stats_enabled && local_stats) {
+    stats_add(&local_stats->counters[counter], 1);
+  }
+}
+
+/** @brief Records the time elapsed since `start` (from `stats_now()`). */
+static inline void stats_record_since(enum Histogram hist, uint64_t start) {
+  if (stats_enabled && local_stats) {
+    stats_add(&local_stats->histograms[hist][histogram_bucket_of(
+                  stats_now() - start)],
+              1);
+  }
+}
+
+#endif /* end of include guard: STATS_H_ */
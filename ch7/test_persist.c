@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* included to reach the file-scope state, so that a crash can be simulated */
+#include "persist.c"
+
+static char dir_path[] = "/tmp/test_persist_XXXXXX";
+
+/* the state to start every resume from scratch with */
+static struct BankState blank_state;
+
+
+void copy_state(struct BankState *out) {
+  memcpy(out->available, available, sizeof(out->available));
+  memcpy(out->maximum, maximum, sizeof(out->maximum));
+  memcpy(out->allocation, allocation, sizeof(out->allocation));
+  memcpy(out->need, need, sizeof(out->need));
+}
+
+bool is_same_as_state(const struct BankState *expected) {
+  struct BankState actual;
+  copy_state(&actual);
+  return memcmp(&actual, expected, sizeof(actual)) == 0;
+}
+
+/**
+ * @brief Stops persisting as if the process were killed: nothing is compacted
+ * and the in-memory state is lost.
+ */
+void crash(void) {
+  close(log_fd);
+  log_fd = -1;
+  log_size = 0;
+  sequence = 0;
+  deltas_since_compaction = 0;
+  is_enabled = false;
+  memset(&blank_state, 0, sizeof(blank_state));
+  use_state(&blank_state);
+}
+
+/** @brief Requests one of each resource for every customer, which are granted. */
+void request_for_all(void) {
+  int request[NUMBER_OF_RESOURCES] = {1, 1, 1};
+  for (int i = 0; i < NUMBER_OF_CUSTOMERS; i++) {
+    assert(request_resources(i, request) == SUCCESS);
+  }
+}
+
+void release_by_one(int customer_num) {
+  int release[NUMBER_OF_RESOURCES] = {1, 1, 1};
+  release_resources(customer_num, release);
+}
+
+/** @return the content of the log, of which the size is put in `size`. */
+char *read_log(off_t *size) {
+  const int fd = open(log_path, O_RDONLY);
+  *size = lseek(fd, 0, SEEK_END);
+  char *content = malloc(*size);
+  assert(pread(fd, content, *size, 0) == *size);
+  close(fd);
+  return content;
+}
+
+void write_log(const char *content, off_t size) {
+  const int fd = open(log_path, O_WRONLY | O_TRUNC);
+  assert(write(fd, content, size) == size);
+  close(fd);
+}
+
+
+int main(int argc, char const *argv[]) {
+  assert(mkdtemp(dir_path));
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/bank.state", dir_path);
+  setenv("BANK_STATE", path, 1);
+
+  /* a fresh start takes the first snapshot */
+  assert(!persist_init());
+  for (int i = 0; i < NUMBER_OF_RESOURCES; i++) {
+    available[i] = 10;
+  }
+  for (int i = 0; i < NUMBER_OF_CUSTOMERS; i++) {
+    for (int j = 0; j < NUMBER_OF_RESOURCES; j++) {
+      maximum[i][j] = need[i][j] = 3;
+    }
+  }
+  assert(persist_compact());
+
+  struct BankState expected;
+
+  /* the deltas logged since the snapshot are replayed */
+  request_for_all();
+  release_by_one(2);
+  copy_state(&expected);
+  crash();
+  assert(persist_init());
+  assert(sequence == NUMBER_OF_CUSTOMERS + 1);
+  assert(log_size == (NUMBER_OF_CUSTOMERS + 1) * sizeof(struct DeltaRecord));
+  assert(is_same_as_state(&expected));
+
+  /* a torn record at the tail is dropped along with nothing before it */
+  release_by_one(0);
+  release_by_one(1);
+  copy_state(&expected);
+  off_t size;
+  char *content = read_log(&size);
+  char *torn = malloc(size + sizeof(struct DeltaRecord) / 2);
+  memcpy(torn, content, size);
+  memset(torn + size, 0x5a, sizeof(struct DeltaRecord) / 2);
+  write_log(torn, size + sizeof(struct DeltaRecord) / 2);
+  crash();
+  assert(persist_init());
+  assert(log_size == size); /* cut off right before the torn record */
+  assert(sequence == NUMBER_OF_CUSTOMERS + 3);
+  assert(is_same_as_state(&expected));
+  free(torn);
+
+  /* a compaction interrupted before truncating the log leaves the deltas
+    already in the snapshot at the front, which are skipped */
+  assert(persist_compact());
+  release_by_one(3);
+  copy_state(&expected);
+  off_t tail_size;
+  char *tail = read_log(&tail_size);
+  assert(tail_size == sizeof(struct DeltaRecord));
+  char *stale = malloc(size + tail_size);
+  memcpy(stale, content, size);
+  memcpy(stale + size, tail, tail_size);
+  write_log(stale, size + tail_size);
+  crash();
+  assert(persist_init());
+  assert(sequence == NUMBER_OF_CUSTOMERS + 4);
+  assert(is_same_as_state(&expected));
+  free(stale);
+  free(tail);
+  free(content);
+
+  /* a delta which can't be appended is caught up with by a snapshot taken at
+    once, which is resumed with no delta to replay */
+  const uint64_t sequence_before_failure = sequence;
+  close(log_fd);
+  log_fd = open(log_path, O_RDONLY); /* makes the append fail */
+  release_by_one(4);
+  copy_state(&expected);
+  struct StateHeader header;
+  const int state_fd = open(state_path, O_RDONLY);
+  assert(read(state_fd, &header, sizeof(header)) == sizeof(header));
+  close(state_fd);
+  assert(header.sequence == sequence_before_failure);
+  crash();
+  assert(persist_init());
+  assert(sequence == sequence_before_failure);
+  assert(is_same_as_state(&expected));
+
+  persist_shutdown();
+  unlink(log_path);
+  unlink(state_path);
+  rmdir(dir_path);
+
+  printf("Persist Test ... (PASSED)\n");
+  return 0;
+}
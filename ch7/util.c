@@ -1,22 +1,27 @@
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "persist.h"
+#include "stats.h"
 #include "util.h"
 
+static struct BankState in_memory_state;
+
 /* the available amount of each resource */
-int available[NUMBER_OF_RESOURCES];
+int *available = in_memory_state.available;
 
 /* the maximum demand of each customer */
-int maximum[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+int (*maximum)[NUMBER_OF_RESOURCES] = in_memory_state.maximum;
 
 /* the amount currently allocated to each customer */
-int allocation[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+int (*allocation)[NUMBER_OF_RESOURCES] = in_memory_state.allocation;
 
 /* the remaining need of each customer */
-int need[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+int (*need)[NUMBER_OF_RESOURCES] = in_memory_state.need;
 
 pthread_mutex_t resource_mutex;
 pthread_mutex_t rand_mutex;
@@ -37,17 +42,26 @@ void read_available(int argc, const char *argv[]) {
   }
 }
 
+void use_state(struct BankState *state) {
+  available = state->available;
+  maximum = state->maximum;
+  allocation = state->allocation;
+  need = state->need;
+}
+
 void *enter_bank(void *customer_num_) {
   const int customer_num = *((int *)customer_num_);
 
+  stats_register_thread(customer_num);
+
   for (int i = 0; i < NUMBER_OF_REQUESTS; i++) {
-    pthread_mutex_lock(&resource_mutex);
+    uint64_t acquired_at = stats_lock(&resource_mutex, HIST_RESOURCE_WAIT);
     make_request(customer_num);
-    pthread_mutex_unlock(&resource_mutex);
+    stats_unlock(&resource_mutex, HIST_RESOURCE_HOLD, acquired_at);
 
-    pthread_mutex_lock(&resource_mutex);
+    acquired_at = stats_lock(&resource_mutex, HIST_RESOURCE_WAIT);
     make_release(customer_num);
-    pthread_mutex_unlock(&resource_mutex);
+    stats_unlock(&resource_mutex, HIST_RESOURCE_HOLD, acquired_at);
   }
 
   pthread_exit(NULL);
@@ -88,15 +102,26 @@ void make_release(int customer_num) {
 void grant_request(int customer_num, int request[]);
 
 enum Status request_resources(int customer_num, int request[]) {
+  BANK_PROBE1(request, customer_num);
+  stats_count(COUNTER_REQUESTS);
+
   grant_request(customer_num, request);
-  if (!is_in_safe_state()) {
+  const uint64_t check_start = stats_now();
+  const bool is_safe = is_in_safe_state();
+  stats_record_since(HIST_SAFETY_CHECK, check_start);
+  if (!is_safe) {
     for (int i = 0; i < NUMBER_OF_RESOURCES; i++) {
       allocation[customer_num][i] -= request[i];
       available[i] += request[i];
       need[customer_num][i] += request[i];
     }
+    BANK_PROBE1(deny, customer_num);
+    stats_count(COUNTER_DENIALS);
     return FAILURE;
   }
+  persist_record(DELTA_GRANT, customer_num, request);
+  BANK_PROBE1(grant, customer_num);
+  stats_count(COUNTER_GRANTS);
   return SUCCESS;
 }
 
@@ -109,18 +134,24 @@ void grant_request(int customer_num, int request[]) {
 }
 
 enum Status release_resources(int customer_num, int release[]) {
+  BANK_PROBE1(release, customer_num);
+  stats_count(COUNTER_RELEASES);
+
   for (int i = 0; i < NUMBER_OF_RESOURCES; i++) {
     allocation[customer_num][i] -= release[i];
     available[i] += release[i];
     need[customer_num][i] += release[i];
   }
+  persist_record(DELTA_RELEASE, customer_num, release);
   return SUCCESS;
 }
 
 int *gen_random_resources(int max[]) {
   int *amount = malloc(sizeof(int) * NUMBER_OF_RESOURCES);
+  const uint64_t wait_start = stats_now();
   pthread_mutex_lock(&rand_mutex);
-  for (int i = 0; i < NUMBER_OF_CUSTOMERS; i++) {
+  stats_record_since(HIST_RAND_WAIT, wait_start);
+  for (int i = 0; i < NUMBER_OF_RESOURCES; i++) {
     amount[i] = max[i] ? rand() % max[i] : 0;
   }
   pthread_mutex_unlock(&rand_mutex);
@@ -12,17 +12,26 @@
   each customer makes this many requests and leave */
 #define NUMBER_OF_REQUESTS 10
 
+/* the whole state of the bank, kept together so that it can be mapped from a
+  file (see persist.h) */
+struct BankState {
+  int available[NUMBER_OF_RESOURCES];
+  int maximum[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+  int allocation[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+  int need[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+};
+
 /* the available amount of each resource */
-extern int available[NUMBER_OF_RESOURCES];
+extern int *available;
 
 /* the maximum demand of each customer */
-extern int maximum[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+extern int (*maximum)[NUMBER_OF_RESOURCES];
 
 /* the amount currently allocated to each customer */
-extern int allocation[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+extern int (*allocation)[NUMBER_OF_RESOURCES];
 
 /* the remaining need of each customer */
-extern int need[NUMBER_OF_CUSTOMERS][NUMBER_OF_RESOURCES];
+extern int (*need)[NUMBER_OF_RESOURCES];
 
 extern pthread_mutex_t resource_mutex;
 extern pthread_mutex_t rand_mutex;
@@ -34,6 +43,12 @@ extern pthread_mutex_t rand_mutex;
  */
 void read_available(int argc, const char *argv[]);
 
+/**
+ * @brief Makes `available`, `maximum`, `allocation` and `need` refer to the
+ * arrays of `state`. They refer to an in-memory state until this is called.
+ */
+void use_state(struct BankState *state);
+
 /**
  * @brief Enters the bank and makes `NUMBER_OF_REQUESTS` requests and releases.
  */